@@ -0,0 +1,26 @@
+#ifndef SIMPLE_READELF_DUMP_H
+#define SIMPLE_READELF_DUMP_H
+#include <elf.h>
+#include <link.h>
+#include <stddef.h>
+
+// Macros
+#define HEX_DUMP_BYTES_PER_LINE 16
+#define HEX_DUMP_LINE_MAX 128
+#define HEX_DUMP_BUFFER 65536
+
+// Structures declaration
+
+// Input file mapped in memory with the section to dump
+typedef struct {
+    int fd;
+    char *map;
+    size_t size;
+    ElfW(Shdr) * section;
+} dump_input;
+
+// Functions declaration
+void dump_section(const char *filename, const char *name, const char *output);
+void hex_dump_section(const char *filename, const char *name);
+
+#endif//SIMPLE_READELF_DUMP_H
@@ -11,6 +11,7 @@
 #define XLAT_END \
     { 0, 0 }
 #define PRINT_PAD 18
+#define SIZE_REPORT_TOP 20
 
 // Global variables declaration
 char *str_sections_name = NULL;
@@ -19,12 +20,19 @@ char *symbol_name = NULL;
 static const char *section_attribute[10] = {"Name", "Type", "Address", "Offset", "Size", "EntSize", "Flags", "Links", "Info", "Align"};
 static const char *program_attribute[8] = {"Type", "Offset", "VirtAddr", "PhysAddr", "FileSiz", "MemSiz", "Flags", "Align"};
 static const char *dynamic_symbol_attribute[8] = {"Num", "Value", "Size", "Type", "Bind", "Vis", "Ndx", "Name"};
+static const char *size_section_attribute[5] = {"Name", "Type", "FileSize", "MemSize", "SymSize"};
+static const char *size_segment_attribute[8] = {"Num", "Offset", "VirtAddr", "FileSiz", "MemSiz", "FileCovered", "MemCovered", "FilePadding"};
+static const char *size_group_attribute[4] = {"Count", "Size", "Percent", "Name"};
+static const char *hash_histogram_attribute[4] = {"Length", "Number", "% of total", "Coverage"};
 static const char *flag_section_keyword_infos = "\nKey to FLAGS:\nW [Write] - A [Alloc] - X [Execute] - M [Merge]\nS [Strings] - I [Infos] - L [Link order]\nO [Extra OS processing required] - G [Group]\nT [TLS] - E [Exclude] - C [Compressed]";
 static const char *flag_program_keyword_infos = "\nKey to FLAGS:\nR [READ] - W [Write] - X [Execute]";
+static const char *usage = "Usage: ./simple-readelf [-a -h -P -S -s -d -I --size-report --watch] <filename>\n"
+                           "       ./simple-readelf [-x <section> | --dump-section <section> -o <output>] <filename>";
 static const char *no_program_headers = "There are no program headers in this file.";
 static const char *no_section_headers = "There are no section headers in this file.";
 static const char *no_symbol_section = "There is no symbol section in this file.";
 static const char *no_dynamic_section = "There is no dynamic section in this file.";
+static const char *no_hash_section = "There is no hash section in this file.";
 
 // Enum declaration
 typedef enum {
@@ -38,19 +46,48 @@ typedef enum {
     SECTION_HEADER,
     PROGRAM_HEADER,
     STATIC_SYMBOL,
-    DYNAMIC_SYMBOL
+    DYNAMIC_SYMBOL,
+    SIZE_REPORT,
+    HASH_HISTOGRAM,
+    WATCH,
+    DUMP_SECTION,
+    HEX_DUMP
 } OPTIONS;
 
 OPTIONS options = 0;
+char *section_to_dump = NULL;
+char *output_filename = NULL;
 
 // Structures declaration
 typedef struct {
     ElfW(Shdr) * dynamic_symbol;
     ElfW(Shdr) * symbol;
+    ElfW(Shdr) * hash;
+    ElfW(Shdr) * gnu_hash;
     size_t str_dynamic_symbol_off;
     size_t str_symbol_off;
 } section_info;
 
+typedef struct {
+    size_t index;
+    size_t file_size;
+    size_t memory_size;
+    size_t symbol_size;
+} section_size;
+
+typedef struct {
+    const char *name;
+    size_t length;
+    size_t count;
+    size_t size;
+} size_group;
+
+typedef struct {
+    size_group *groups;
+    size_t capacity;
+    size_t used;
+} size_group_table;
+
 typedef struct {
     size_t value;
     const char *string;
@@ -140,6 +177,17 @@ xlat dyn_sym_type[] =
                 XLAT(STT_HIPROC),
                 XLAT_END};
 
+// GNU values sharing the OS specific range, used where they take precedence
+xlat gnu_sym_type[] =
+        {
+                XLAT(STT_GNU_IFUNC),
+                XLAT_END};
+
+xlat gnu_sym_bind[] =
+        {
+                XLAT(STB_GNU_UNIQUE),
+                XLAT_END};
+
 xlat dyn_sym_bind[] =
         {
                 XLAT(STB_LOCAL),
@@ -10,6 +10,7 @@
 // Functions declaration
 void auto_pad(const char *string, size_t target_length);
 void auto_pad_number(int number, const char *format, size_t target_length, int is_address);
+void auto_pad_size(size_t number, size_t target_length);
 void pretty_print_magic(unsigned char *string);
 void printer_indent(const char *title, const char *format, ...);
 char *pretty_print_header_data(int data);
@@ -17,5 +18,7 @@ char *pretty_print_header_type(int type);
 char *pretty_print_header_osabi(int os_abi);
 char *section_flag_selector(uint64_t flag);
 char *program_flag_selector(uint64_t flag);
+const char *symbol_prefix(const char *name, size_t *length);
+uint64_t hash_string(const char *string, size_t length);
 
 #endif//SIMPLE_READELF_TOOLS_H
@@ -0,0 +1,54 @@
+#ifndef SIMPLE_READELF_WATCH_H
+#define SIMPLE_READELF_WATCH_H
+#include <elf.h>
+#include <link.h>
+#include <stddef.h>
+
+// Macros
+#define WATCH_EVENT_BUFFER 4096
+#define WATCH_BUCKETS 1024
+
+// Structures declaration
+
+// Parsed subset of an ELF file kept between two link steps
+typedef struct {
+    ElfW(Ehdr) header;
+    ElfW(Shdr) * sections;
+    char *section_names;
+    size_t section_names_size;
+    ElfW(Sym) * symbols;
+    size_t nb_symbols;
+    char *symbol_names;
+    size_t symbol_names_size;
+} watch_snapshot;
+
+typedef struct watch_entry {
+    char *path;
+    watch_snapshot snapshot;
+    int removed;
+    struct watch_entry *next;
+} watch_entry;
+
+typedef struct {
+    int fd;
+    char **paths;
+    size_t nb_paths;
+    watch_entry **entries;
+    size_t nb_buckets;
+    size_t nb_entries;
+} watch_context;
+
+typedef struct {
+    const char *name;
+    const ElfW(Shdr) * section;
+} watch_section;
+
+typedef struct {
+    const char *name;
+    const ElfW(Sym) * symbol;
+} watch_symbol;
+
+// Functions declaration
+void watch_directory(const char *path);
+
+#endif//SIMPLE_READELF_WATCH_H
@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+#include "dump.h"
+#include "tools.h"
+#include <elf.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Map the input file and find a section by name, only the touched pages are read
+static dump_input dump_open(const char *filename, const char *name) {
+    dump_input input = {.fd = open(filename, O_RDONLY), .map = NULL, .size = 0, .section = NULL};
+    struct stat status;
+
+    if (input.fd < 0 || fstat(input.fd, &status) < 0)
+        errx(1, "Cannot open file !");
+
+    input.size = (size_t) status.st_size;
+    if (input.size < sizeof(ElfW(Ehdr)))
+        errx(1, "Not an ELF file !");
+
+    input.map = mmap(NULL, input.size, PROT_READ, MAP_PRIVATE, input.fd, 0);
+    if (input.map == MAP_FAILED)
+        errx(1, "Cannot map file !");
+
+    ElfW(Ehdr) *header = (ElfW(Ehdr) *) input.map;
+    if (memcmp(header->e_ident, ELFMAG, SELFMAG) != 0)
+        errx(1, "Not an ELF file !");
+    if (header->e_shoff > input.size || (input.size - header->e_shoff) / sizeof(ElfW(Shdr)) < header->e_shnum || header->e_shstrndx >= header->e_shnum)
+        errx(1, "Cannot get sections names !");
+
+    ElfW(Shdr) *sections = (ElfW(Shdr) *) (input.map + header->e_shoff);
+    ElfW(Shdr) *names = &sections[header->e_shstrndx];
+    if (names->sh_offset > input.size || names->sh_size > input.size - names->sh_offset)
+        errx(1, "Cannot get sections names !");
+
+    for (size_t i = 0; i < header->e_shnum; i++) {
+        if (sections[i].sh_name < names->sh_size && strncmp(input.map + names->sh_offset + sections[i].sh_name, name, names->sh_size - sections[i].sh_name) == 0) {
+            input.section = &sections[i];
+            break;
+        }
+    }
+    if (!input.section)
+        errx(1, "Cannot find section '%s' !", name);
+    if (input.section->sh_type != SHT_NOBITS && (input.section->sh_offset > input.size || input.section->sh_size > input.size - input.section->sh_offset))
+        errx(1, "Section '%s' is out of the file !", name);
+
+    return input;
+}
+
+static void dump_close(dump_input *input) {
+    munmap(input->map, input->size);
+    close(input->fd);
+}
+
+// Copy the section bytes to the output file inside the kernel
+void dump_section(const char *filename, const char *name, const char *output) {
+    dump_input input = dump_open(filename, name);
+
+    if (input.section->sh_type == SHT_NOBITS)
+        errx(1, "Section '%s' has no data to dump !", name);
+
+    int out = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0)
+        errx(1, "Cannot open output file !");
+
+    size_t remaining = input.section->sh_size;
+    loff_t offset = (loff_t) input.section->sh_offset;
+
+    // copy_file_range can share extents on the same file system, sendfile works everywhere else
+    while (remaining > 0) {
+        ssize_t copied = copy_file_range(input.fd, &offset, out, NULL, remaining, 0);
+        if (copied <= 0) {
+            if (copied < 0 && errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP)
+                err(1, "Cannot copy section");
+            break;
+        }
+        remaining -= (size_t) copied;
+    }
+    off_t sendfile_offset = (off_t) offset;
+    while (remaining > 0) {
+        ssize_t copied = sendfile(out, input.fd, &sendfile_offset, remaining);
+        if (copied <= 0)
+            err(1, "Cannot copy section");
+        remaining -= (size_t) copied;
+    }
+
+    close(out);
+    printf("Dumped %zu bytes of section '%s' to %s\n", (size_t) input.section->sh_size, name, output);
+    dump_close(&input);
+}
+
+// Write the address column of a line, return the number of chars written
+static size_t hex_dump_address(char *out, size_t address, size_t digits) {
+    out[0] = ' ';
+    out[1] = ' ';
+    out[2] = '0';
+    out[3] = 'x';
+    for (size_t i = 0; i < digits; i++) {
+        out[4 + i] = hex_digits[(address >> (4 * (digits - 1 - i))) & 0xf];
+    }
+    out[4 + digits] = ' ';
+    return digits + 5;
+}
+
+// Format a possibly partial line byte per byte
+static size_t hex_dump_line_scalar(char *out, const unsigned char *data, size_t length) {
+    size_t index = 0;
+
+    for (size_t i = 0; i < HEX_DUMP_BYTES_PER_LINE; i++) {
+        if (i < length) {
+            out[index++] = hex_digits[data[i] >> 4];
+            out[index++] = hex_digits[data[i] & 0xf];
+        } else {
+            out[index++] = ' ';
+            out[index++] = ' ';
+        }
+        if (i % 4 == 3)
+            out[index++] = ' ';
+    }
+    for (size_t i = 0; i < length; i++) {
+        out[index++] = data[i] >= 0x20 && data[i] < 0x7f ? (char) data[i] : '.';
+    }
+    out[index++] = '\n';
+    return index;
+}
+
+#ifdef __SSE2__
+// Convert nibbles to their lowercase hex digit
+static __m128i hex_dump_digits(__m128i nibbles) {
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+// Format a full line 16 bytes at a time
+static size_t hex_dump_line(char *out, const unsigned char *data) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *) data);
+    __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+    __m128i low = _mm_and_si128(bytes, mask);
+
+    // Interleave nibbles so each byte gives its two digits in order
+    __m128i first = hex_dump_digits(_mm_unpacklo_epi8(high, low));
+    __m128i second = hex_dump_digits(_mm_unpackhi_epi8(high, low));
+    _mm_storel_epi64((__m128i *) out, first);
+    _mm_storel_epi64((__m128i *) (out + 9), _mm_srli_si128(first, 8));
+    _mm_storel_epi64((__m128i *) (out + 18), second);
+    _mm_storel_epi64((__m128i *) (out + 27), _mm_srli_si128(second, 8));
+    out[8] = ' ';
+    out[17] = ' ';
+    out[26] = ' ';
+    out[35] = ' ';
+
+    // Bytes above 0x7f are negative, so the signed compare also rejects them
+    __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1f)), _mm_cmplt_epi8(bytes, _mm_set1_epi8(0x7f)));
+    __m128i ascii = _mm_or_si128(_mm_and_si128(printable, bytes), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+    _mm_storeu_si128((__m128i *) (out + 36), ascii);
+    out[52] = '\n';
+    return 53;
+}
+#else
+static size_t hex_dump_line(char *out, const unsigned char *data) {
+    return hex_dump_line_scalar(out, data, HEX_DUMP_BYTES_PER_LINE);
+}
+#endif
+
+// Pretty print the content of a section in hex and ASCII
+void hex_dump_section(const char *filename, const char *name) {
+    dump_input input = dump_open(filename, name);
+
+    if (input.section->sh_type == SHT_NOBITS || input.section->sh_size == 0) {
+        printf("Section '%s' has no data to dump.\n", name);
+        dump_close(&input);
+        return;
+    }
+
+    const unsigned char *data = (const unsigned char *) input.map + input.section->sh_offset;
+    size_t size = input.section->sh_size;
+    size_t address = input.section->sh_addr;
+    size_t digits = address + size > 0xffffffff ? 16 : 8;
+
+    // The section is read once front to back
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t start = input.section->sh_offset & ~(page - 1);
+    madvise(input.map + start, input.section->sh_offset + size - start, MADV_SEQUENTIAL);
+
+    printf("\nHex dump of section '%s':\n", name);
+
+    static char buffer[HEX_DUMP_BUFFER];
+    size_t used = 0;
+    for (size_t i = 0; i < size; i += HEX_DUMP_BYTES_PER_LINE) {
+        if (used > HEX_DUMP_BUFFER - HEX_DUMP_LINE_MAX) {
+            fwrite(buffer, 1, used, stdout);
+            used = 0;
+        }
+        used += hex_dump_address(buffer + used, address + i, digits);
+        if (size - i >= HEX_DUMP_BYTES_PER_LINE)
+            used += hex_dump_line(buffer + used, data + i);
+        else
+            used += hex_dump_line_scalar(buffer + used, data + i, size - i);
+    }
+    fwrite(buffer, 1, used, stdout);
+    putchar('\n');
+
+    dump_close(&input);
+}
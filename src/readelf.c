@@ -1,12 +1,18 @@
 #include "readelf.h"
+#include "dump.h"
 #include "tools.h"
+#include "watch.h"
 #include <elf.h>
 #include <err.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <link.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Find correct name parameter in xlat
 const char *xlat_get(xlat *xlat_arr, size_t val) {
@@ -77,6 +83,10 @@ static void pretty_print_section_header(ElfW(Shdr) * section, size_t number, sec
             section_info->symbol = &section[i];
         } else if (section[i].sh_type == SHT_DYNSYM) {
             section_info->dynamic_symbol = &section[i];
+        } else if (section[i].sh_type == SHT_HASH) {
+            section_info->hash = &section[i];
+        } else if (section[i].sh_type == SHT_GNU_HASH) {
+            section_info->gnu_hash = &section[i];
         }
 
         if (strcmp(name, ".dynstr") == 0) {
@@ -186,6 +196,361 @@ static void pretty_print_symbol(ElfW(Sym) * symbol, size_t number, SYMBOL type)
     }
 }
 
+// Print the bucket list length histogram and the lookup cost of a hash table
+static void pretty_print_hash_lengths(const char *name, size_t *lengths, size_t max_length, size_t nb_buckets, size_t nb_symbols) {
+    printf("Histogram for '%s' bucket list length (total of %zu buckets):\n", name, nb_buckets);
+    for (size_t i = 0; i < 4; i++) {
+        auto_pad(hash_histogram_attribute[i], PRINT_PAD);
+    }
+    putchar('\n');
+
+    // A symbol at position k of its chain costs k probes when found
+    size_t covered = 0;
+    size_t hit_probes = 0;
+    for (size_t i = 0; i <= max_length; i++) {
+        char percent[16] = {0};
+        char coverage[16] = {0};
+        covered += i * lengths[i];
+        hit_probes += lengths[i] * i * (i + 1) / 2;
+        snprintf(percent, sizeof(percent), "%.1f%%", nb_buckets ? 100.0 * (double) lengths[i] / (double) nb_buckets : 0.0);
+        snprintf(coverage, sizeof(coverage), "%.1f%%", nb_symbols ? 100.0 * (double) covered / (double) nb_symbols : 0.0);
+
+        auto_pad_size(i, PRINT_PAD);
+        auto_pad_size(lengths[i], PRINT_PAD);
+        auto_pad(percent, PRINT_PAD);
+        auto_pad(coverage, PRINT_PAD);
+        putchar('\n');
+    }
+
+    printf(INDENT "Empty buckets: %zu, longest chain: %zu\n", lengths[0], max_length);
+    printf(INDENT "Expected probes per successful lookup: %.2f\n", nb_symbols ? (double) hit_probes / (double) nb_symbols : 0.0);
+}
+
+// Walk the SysV hash section: nbucket, nchain, buckets[nbucket], chains[nchain]
+static void pretty_print_hash(char *buffer, ElfW(Shdr) * section) {
+    uint32_t *words = (uint32_t *) (buffer + section->sh_offset);
+    size_t nb_words = section->sh_size / sizeof(uint32_t);
+
+    if (nb_words < 2 || 2 + (size_t) words[0] + words[1] > nb_words)
+        errx(1, "Corrupted hash section !");
+
+    size_t nb_buckets = words[0];
+    size_t nb_chains = words[1];
+    uint32_t *buckets = &words[2];
+    uint32_t *chains = &words[2 + nb_buckets];
+
+    size_t *lengths = calloc(nb_chains + 1, sizeof(size_t));
+    if (!lengths)
+        errx(1, "Cannot malloc hash histogram !");
+
+    size_t max_length = 0;
+    size_t nb_symbols = 0;
+    for (size_t i = 0; i < nb_buckets; i++) {
+        size_t length = 0;
+        for (uint32_t index = buckets[i]; index != STN_UNDEF && index < nb_chains && length < nb_chains; index = chains[index]) {
+            length++;
+        }
+        lengths[length]++;
+        nb_symbols += length;
+        if (length > max_length)
+            max_length = length;
+    }
+
+    pretty_print_hash_lengths(".hash", lengths, max_length, nb_buckets, nb_symbols);
+    // Every miss walks the whole chain of its bucket
+    printf(INDENT "Expected probes per unsuccessful lookup: %.2f\n", nb_buckets ? (double) nb_symbols / (double) nb_buckets : 0.0);
+    free(lengths);
+}
+
+// Walk the GNU hash section: nbuckets, symoffset, bloom_size, bloom_shift, bloom[], buckets[], chains[]
+static void pretty_print_gnu_hash(char *buffer, ElfW(Shdr) * section, ElfW(Shdr) * sections, size_t number) {
+    uint32_t *words = (uint32_t *) (buffer + section->sh_offset);
+
+    // Chains run up to the end of the symbol table the section is linked to
+    if (section->sh_link >= number || sections[section->sh_link].sh_type != SHT_DYNSYM)
+        errx(1, "GNU hash section is not linked to a dynamic symbol table !");
+    size_t nb_dynamic_symbols = sections[section->sh_link].sh_size / sizeof(ElfW(Sym));
+
+    if (section->sh_size < 4 * sizeof(uint32_t))
+        errx(1, "Corrupted GNU hash section !");
+
+    size_t nb_buckets = words[0];
+    size_t symbol_offset = words[1];
+    size_t bloom_size = words[2];
+    ElfW(Addr) *bloom = (ElfW(Addr) *) &words[4];
+    uint32_t *buckets = (uint32_t *) &bloom[bloom_size];
+    uint32_t *chains = &buckets[nb_buckets];
+    size_t nb_chains = nb_dynamic_symbols > symbol_offset ? nb_dynamic_symbols - symbol_offset : 0;
+
+    if (4 * sizeof(uint32_t) + bloom_size * sizeof(ElfW(Addr)) + (nb_buckets + nb_chains) * sizeof(uint32_t) > section->sh_size)
+        errx(1, "Corrupted GNU hash section !");
+
+    size_t *lengths = calloc(nb_chains + 1, sizeof(size_t));
+    if (!lengths)
+        errx(1, "Cannot malloc hash histogram !");
+
+    // The last symbol of a chain has the lowest bit of its hash set
+    size_t max_length = 0;
+    size_t nb_symbols = 0;
+    for (size_t i = 0; i < nb_buckets; i++) {
+        size_t length = 0;
+        if (buckets[i] >= symbol_offset) {
+            for (size_t index = buckets[i] - symbol_offset; index < nb_chains; index++) {
+                length++;
+                if (chains[index] & 1)
+                    break;
+            }
+        }
+        lengths[length]++;
+        nb_symbols += length;
+        if (length > max_length)
+            max_length = length;
+    }
+
+    size_t bloom_bits = 0;
+    for (size_t i = 0; i < bloom_size; i++) {
+        bloom_bits += (size_t) __builtin_popcountll((unsigned long long) bloom[i]);
+    }
+    double fill = bloom_size ? (double) bloom_bits / (double) (bloom_size * sizeof(ElfW(Addr)) * 8) : 1.0;
+
+    pretty_print_hash_lengths(".gnu.hash", lengths, max_length, nb_buckets, nb_symbols);
+    // Each symbol sets two bits, so a miss passes the bloom filter with probability fill^2
+    printf(INDENT "Bloom filter: %zu words, %zu bits set, fill ratio %.1f%%\n", bloom_size, bloom_bits, 100.0 * fill);
+    printf(INDENT "Expected probes per unsuccessful lookup: %.2f\n", nb_buckets ? fill * fill * (double) nb_symbols / (double) nb_buckets : 0.0);
+    free(lengths);
+}
+
+// Order sections by decreasing file size, then memory size
+static int compare_section_size(const void *a, const void *b) {
+    const section_size *left = a;
+    const section_size *right = b;
+
+    if (left->file_size != right->file_size)
+        return left->file_size < right->file_size ? 1 : -1;
+    if (left->memory_size != right->memory_size)
+        return left->memory_size < right->memory_size ? 1 : -1;
+    return (left->index > right->index) - (left->index < right->index);
+}
+
+// Order groups by decreasing size, then count
+static int compare_size_group(const void *a, const void *b) {
+    const size_group *left = a;
+    const size_group *right = b;
+
+    if (left->size != right->size)
+        return left->size < right->size ? 1 : -1;
+    if (left->count != right->count)
+        return left->count < right->count ? 1 : -1;
+    return 0;
+}
+
+// Find or create the group of a prefix with linear probing
+static size_group *size_group_lookup(size_group *groups, size_t capacity, const char *name, size_t length) {
+    uint64_t hash = hash_string(name, length);
+
+    for (size_t slot = hash & (capacity - 1);; slot = (slot + 1) & (capacity - 1)) {
+        size_group *group = &groups[slot];
+        if (!group->name) {
+            group->name = name;
+            group->length = length;
+            return group;
+        }
+        if (group->length == length && memcmp(group->name, name, length) == 0)
+            return group;
+    }
+}
+
+// Account symbol bytes to a prefix, growing the table only when half full
+static void size_group_add(size_group_table *table, const char *name, size_t length, size_t size) {
+    if ((table->used + 1) * 2 > table->capacity) {
+        size_t capacity = table->capacity ? table->capacity * 2 : 1024;
+        size_group *groups = calloc(capacity, sizeof(size_group));
+
+        if (!groups)
+            errx(1, "Cannot malloc size report !");
+
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->groups[i].name)
+                *size_group_lookup(groups, capacity, table->groups[i].name, table->groups[i].length) = table->groups[i];
+        }
+        free(table->groups);
+        table->groups = groups;
+        table->capacity = capacity;
+    }
+
+    size_group *group = size_group_lookup(table->groups, table->capacity, name, length);
+    if (group->count == 0)
+        table->used++;
+    group->count++;
+    group->size += size;
+}
+
+// Print groups sorted by size, at most limit of them
+static void pretty_print_size_group(const char *title, size_group *groups, size_t number, size_t total, size_t limit) {
+    size_t used = 0;
+    for (size_t i = 0; i < number; i++) {
+        if (groups[i].count)
+            groups[used++] = groups[i];
+    }
+    qsort(groups, used, sizeof(size_group), compare_size_group);
+
+    printf("\n%s:\n", title);
+    for (size_t i = 0; i < 4; i++) {
+        auto_pad(size_group_attribute[i], PRINT_PAD);
+    }
+    putchar('\n');
+
+    for (size_t i = 0; i < used && i < limit; i++) {
+        char percent[16] = {0};
+        snprintf(percent, sizeof(percent), "%.2f%%", total ? 100.0 * (double) groups[i].size / (double) total : 0.0);
+
+        auto_pad_size(groups[i].count, PRINT_PAD);
+        auto_pad_size(groups[i].size, PRINT_PAD);
+        auto_pad(percent, PRINT_PAD);
+        if (groups[i].length)
+            printf("%.*s\n", (int) groups[i].length, groups[i].name);
+        else
+            puts("(none)");
+    }
+    if (used > limit)
+        printf("... %zu more\n", used - limit);
+}
+
+// Pretty print the attribution of file and memory bytes to sections, segments and symbols
+static void pretty_print_size_report(char *buffer, ElfW(Shdr) * section, size_t number, ElfW(Phdr) * programs, size_t program_number, section_info *section_info) {
+    // Check presence of sections headers
+    if (number == 0) {
+        printf("%s\n", no_section_headers);
+        return;
+    }
+
+    section_size *sizes = calloc(number, sizeof(section_size));
+    if (!sizes)
+        errx(1, "Cannot malloc size report !");
+
+    size_t total_file = 0;
+    size_t total_memory = 0;
+    size_t not_loaded = 0;
+    for (size_t i = 0; i < number; i++) {
+        sizes[i].index = i;
+        sizes[i].file_size = section[i].sh_type == SHT_NOBITS ? 0 : section[i].sh_size;
+        sizes[i].memory_size = section[i].sh_flags & SHF_ALLOC ? section[i].sh_size : 0;
+        total_file += sizes[i].file_size;
+        total_memory += sizes[i].memory_size;
+        if (!(section[i].sh_flags & SHF_ALLOC))
+            not_loaded += sizes[i].file_size;
+    }
+
+    // Attribute symbols to sections, types, bindings and prefixes in a single pass
+    size_group by_type[16] = {{0}};
+    size_group by_bind[16] = {{0}};
+    size_group_table by_prefix = {.groups = NULL, .capacity = 0, .used = 0};
+    size_t total_symbol = 0;
+
+    ElfW(Shdr) *symbol_section = section_info->symbol ? section_info->symbol : section_info->dynamic_symbol;
+    if (symbol_section) {
+        char *names = buffer + (section_info->symbol ? section_info->str_symbol_off : section_info->str_dynamic_symbol_off);
+        ElfW(Sym) *symbol = (ElfW(Sym) *) (buffer + symbol_section->sh_offset);
+        size_t number_symbol = symbol_section->sh_size / sizeof(ElfW(Sym));
+
+        for (size_t i = 1; i < number_symbol; i++) {
+            // Imports take no room in this file
+            if (symbol[i].st_shndx == SHN_UNDEF)
+                continue;
+
+            size_t size = symbol[i].st_size;
+            size_group *type = &by_type[ELF64_ST_TYPE(symbol[i].st_info)];
+            size_group *bind = &by_bind[ELF64_ST_BIND(symbol[i].st_info)];
+
+            type->count++;
+            type->size += size;
+            bind->count++;
+            bind->size += size;
+            total_symbol += size;
+
+            if (symbol[i].st_shndx < number)
+                sizes[symbol[i].st_shndx].symbol_size += size;
+
+            size_t length = 0;
+            const char *prefix = symbol_prefix(&names[symbol[i].st_name], &length);
+            size_group_add(&by_prefix, prefix, length, size);
+        }
+    }
+
+    // Sections
+    puts("Size report:");
+    puts("\nSections:");
+    for (size_t i = 0; i < 5; i++) {
+        auto_pad(size_section_attribute[i], PRINT_PAD);
+    }
+    putchar('\n');
+
+    qsort(sizes, number, sizeof(section_size), compare_section_size);
+    for (size_t i = 0; i < number; i++) {
+        ElfW(Shdr) *current = &section[sizes[i].index];
+        auto_pad(&str_sections_name[current->sh_name], PRINT_PAD);
+        auto_pad(xlat_get(sh_type, current->sh_type), PRINT_PAD);
+        auto_pad_size(sizes[i].file_size, PRINT_PAD);
+        auto_pad_size(sizes[i].memory_size, PRINT_PAD);
+        auto_pad_size(sizes[i].symbol_size, PRINT_PAD);
+        putchar('\n');
+    }
+    printf("Total: %zu file bytes, %zu memory bytes, %zu file bytes not loaded\n", total_file, total_memory, not_loaded);
+    free(sizes);
+
+    // Segments, covered by the allocated sections they contain
+    puts("\nSegments (PT_LOAD):");
+    for (size_t i = 0; i < 8; i++) {
+        auto_pad(size_segment_attribute[i], PRINT_PAD);
+    }
+    putchar('\n');
+
+    for (size_t i = 0; i < program_number; i++) {
+        if (programs[i].p_type != PT_LOAD)
+            continue;
+
+        size_t covered = 0;
+        size_t memory_covered = 0;
+        for (size_t j = 0; j < number; j++) {
+            if (!(section[j].sh_flags & SHF_ALLOC))
+                continue;
+            if (section[j].sh_type != SHT_NOBITS && section[j].sh_offset >= programs[i].p_offset && section[j].sh_offset + section[j].sh_size <= programs[i].p_offset + programs[i].p_filesz)
+                covered += section[j].sh_size;
+            // .tbss only describes the TLS template, it takes no room in the segment
+            if (section[j].sh_type == SHT_NOBITS && (section[j].sh_flags & SHF_TLS))
+                continue;
+            if (section[j].sh_addr >= programs[i].p_vaddr && section[j].sh_addr + section[j].sh_size <= programs[i].p_vaddr + programs[i].p_memsz)
+                memory_covered += section[j].sh_size;
+        }
+
+        auto_pad_size(i, PRINT_PAD);
+        auto_pad_number((int) programs[i].p_offset, "%x", PRINT_PAD, 1);
+        auto_pad_number((int) programs[i].p_vaddr, "%x", PRINT_PAD, 1);
+        auto_pad_size(programs[i].p_filesz, PRINT_PAD);
+        auto_pad_size(programs[i].p_memsz, PRINT_PAD);
+        auto_pad_size(covered, PRINT_PAD);
+        auto_pad_size(memory_covered, PRINT_PAD);
+        auto_pad_size(programs[i].p_filesz > covered ? programs[i].p_filesz - covered : 0, PRINT_PAD);
+        putchar('\n');
+    }
+
+    // Symbols
+    if (!symbol_section) {
+        printf("\n%s\n", no_symbol_section);
+        return;
+    }
+    for (size_t i = 0; i < 16; i++) {
+        by_type[i].name = xlat_get(gnu_sym_type, i) ? xlat_get(gnu_sym_type, i) : xlat_get(dyn_sym_type, i);
+        by_type[i].length = by_type[i].name ? strlen(by_type[i].name) : 0;
+        by_bind[i].name = xlat_get(gnu_sym_bind, i) ? xlat_get(gnu_sym_bind, i) : xlat_get(dyn_sym_bind, i);
+        by_bind[i].length = by_bind[i].name ? strlen(by_bind[i].name) : 0;
+    }
+    pretty_print_size_group("Symbols by type", by_type, 16, total_symbol, 16);
+    pretty_print_size_group("Symbols by binding", by_bind, 16, total_symbol, 16);
+    pretty_print_size_group("Symbols by prefix", by_prefix.groups, by_prefix.capacity, total_symbol, SIZE_REPORT_TOP);
+    free(by_prefix.groups);
+}
+
 // Process input file
 static char *open_wrapper(char *filename) {
     size_t buffer_size = 1000;
@@ -220,10 +585,35 @@ static char *open_wrapper(char *filename) {
     return buffer;
 }
 
+// Map input file, pages are only read when the report touches them
+static char *map_wrapper(char *filename, size_t *size) {
+    int fd = open(filename, O_RDONLY);
+    struct stat status;
+
+    if (fd < 0 || fstat(fd, &status) < 0)
+        errx(1, "Cannot open file !");
+
+    *size = (size_t) status.st_size;
+    if (*size < sizeof(ElfW(Ehdr)))
+        errx(1, "Not an ELF file !");
+
+    char *buffer = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (buffer == MAP_FAILED)
+        errx(1, "Cannot map file !");
+
+    close(fd);
+    return buffer;
+}
+
 static char *parse_options(int argc, char **argv) {
+    static struct option long_options[] = {
+            {"size-report", required_argument, NULL, 'z'},
+            {"watch", required_argument, NULL, 'w'},
+            {"dump-section", required_argument, NULL, 'D'},
+            {NULL, 0, NULL, 0}};
     char *filename = NULL;
     int opt;
-    while ((opt = getopt(argc, argv, "a:h:P:S:s:d:")) != -1) {
+    while ((opt = getopt_long(argc, argv, "a:h:P:S:s:d:I:x:o:", long_options, NULL)) != -1) {
         switch (opt) {
             case 'a':
                 options = ALL;
@@ -249,12 +639,42 @@ static char *parse_options(int argc, char **argv) {
                 options = DYNAMIC_SYMBOL;
                 filename = optarg;
                 break;
+            case 'I':
+                options = HASH_HISTOGRAM;
+                filename = optarg;
+                break;
+            case 'z':
+                options = SIZE_REPORT;
+                filename = optarg;
+                break;
+            case 'w':
+                options = WATCH;
+                filename = optarg;
+                break;
+            case 'D':
+                options = DUMP_SECTION;
+                section_to_dump = optarg;
+                break;
+            case 'x':
+                options = HEX_DUMP;
+                section_to_dump = optarg;
+                break;
+            case 'o':
+                output_filename = optarg;
+                break;
             default:
-                errx(1, "Usage: ./simple-readelf [-a -h -P -S -s -d] <filename>");
+                errx(1, "%s", usage);
         }
     }
+    // Section dumps take the section name as argument and the file last
+    if (options == DUMP_SECTION || options == HEX_DUMP) {
+        if (optind != argc - 1 || (options == DUMP_SECTION) != (output_filename != NULL)) {
+            errx(1, "Usage: ./simple-readelf [-x <section> | --dump-section <section> -o <output>] <filename>");
+        }
+        return argv[optind];
+    }
     if (optind != 3) {
-        errx(1, "Usage: ./simple-readelf [-a -h -P -S -s -d] <filename>");
+        errx(1, "%s", usage);
     }
     return filename;
 }
@@ -263,8 +683,23 @@ static char *parse_options(int argc, char **argv) {
 int main(int argc, char **argv) {
     // Parse command line options
     char *filename = parse_options(argc, argv);
-    // Copy content file inside a buffer
-    char *buffer = open_wrapper(filename);
+    // Watch a directory instead of reading a single file
+    if (options == WATCH) {
+        watch_directory(filename);
+        return 0;
+    }
+    // Dump a section straight from the mapped file
+    if (options == DUMP_SECTION) {
+        dump_section(filename, section_to_dump, output_filename);
+        return 0;
+    }
+    if (options == HEX_DUMP) {
+        hex_dump_section(filename, section_to_dump);
+        return 0;
+    }
+    // Copy content file inside a buffer, large binaries of the size report are mapped instead
+    size_t mapped_size = 0;
+    char *buffer = options == SIZE_REPORT ? map_wrapper(filename, &mapped_size) : open_wrapper(filename);
 
     // Get the elf header with the buffer address
     ElfW(Ehdr) *elf_header = (ElfW(Ehdr) *) buffer;
@@ -276,7 +711,7 @@ int main(int argc, char **argv) {
     ElfW(Shdr) str_section_name_s = sections_header[elf_header->e_shstrndx];
 
     size_t nb_sections = elf_header->e_shnum;
-    section_info s_info = {.symbol = NULL, .dynamic_symbol = NULL, .str_symbol_off = 0, .str_dynamic_symbol_off = 0};
+    section_info s_info = {.symbol = NULL, .dynamic_symbol = NULL, .hash = NULL, .gnu_hash = NULL, .str_symbol_off = 0, .str_dynamic_symbol_off = 0};
 
     // Pretty print ELF header
     if (options == ALL || options == HEADER) {
@@ -292,6 +727,23 @@ int main(int argc, char **argv) {
     if (options == ALL || options == PROGRAM_HEADER) {
         pretty_print_program_header(program_header, elf_header->e_phnum);
     }
+    // Pretty print size attribution report
+    if (options == SIZE_REPORT) {
+        pretty_print_size_report(buffer, sections_header, nb_sections, program_header, elf_header->e_phnum, &s_info);
+    }
+    // Pretty print hash tables histogram
+    if (options == HASH_HISTOGRAM) {
+        if (!s_info.hash && !s_info.gnu_hash)
+            printf("%s\n", no_hash_section);
+        if (s_info.gnu_hash) {
+            pretty_print_gnu_hash(buffer, s_info.gnu_hash, sections_header, nb_sections);
+        }
+        if (s_info.hash) {
+            if (s_info.gnu_hash)
+                putchar('\n');
+            pretty_print_hash(buffer, s_info.hash);
+        }
+    }
     // Pretty print dynamic symbol table
     if (options == ALL || options == DYNAMIC_SYMBOL) {
         if (s_info.dynamic_symbol) {
@@ -325,7 +777,10 @@ int main(int argc, char **argv) {
         }
     }
     // Free buffer memory
-    free(buffer);
+    if (mapped_size)
+        munmap(buffer, mapped_size);
+    else
+        free(buffer);
 
     return 0;
 }
@@ -31,6 +31,15 @@ void auto_pad_number(int number, const char *format, size_t target_length, int i
     auto_pad(number_str, target_length);
 }
 
+// Write on stdout a size without truncation to int and pad it with spaces
+void auto_pad_size(size_t number, size_t target_length) {
+    char number_str[32] = {0};
+    if (snprintf(number_str, sizeof(number_str), "%zu", number) < 0) {
+        errx(1, "Error during convert number to string !");
+    }
+    auto_pad(number_str, target_length);
+}
+
 // Write on stdout the string and pad it with spaces to respect the target total length
 void auto_pad(const char *string, size_t target_length) {
     if (!string) {
@@ -205,3 +214,122 @@ char *program_flag_selector(uint64_t flag) {
     }
     return res;
 }
+
+// Read the length prefix of an Itanium mangled source name
+static const char *mangled_source_name(const char *name, size_t *length) {
+    size_t value = 0;
+    const char *cursor = name;
+
+    while (*cursor >= '0' && *cursor <= '9') {
+        value = value * 10 + (size_t) (*cursor - '0');
+        cursor++;
+    }
+    if (cursor == name || value == 0 || memchr(cursor, '\0', value)) {
+        return NULL;
+    }
+    *length = value;
+    return cursor;
+}
+
+// Skip an Itanium call offset (h <number> _ or v <number> _ <number> _) of a thunk name
+static const char *mangled_call_offset(const char *cursor) {
+    size_t numbers = 0;
+
+    if (*cursor == 'h')
+        numbers = 1;
+    else if (*cursor == 'v')
+        numbers = 2;
+    else
+        return NULL;
+    cursor++;
+
+    for (size_t i = 0; i < numbers; i++) {
+        if (*cursor == 'n')
+            cursor++;
+        if (*cursor < '0' || *cursor > '9')
+            return NULL;
+        while (*cursor >= '0' && *cursor <= '9') {
+            cursor++;
+        }
+        if (*cursor != '_')
+            return NULL;
+        cursor++;
+    }
+    return cursor;
+}
+
+// Return the grouping prefix of a symbol name without copying it.
+// Mangled C++ names are grouped by their outermost scope (namespace or class),
+// other names by their first word delimited by '_', '.', '@' or '$'.
+const char *symbol_prefix(const char *name, size_t *length) {
+    const char *cursor = name;
+
+    if (strncmp(cursor, "_Z", 2) == 0) {
+        cursor += 2;
+        // Special names (vtables, typeinfo, guard variables...) are grouped with their type,
+        // thunks with the function they adjust
+        if (cursor[0] == 'T' && (cursor[1] == 'h' || cursor[1] == 'v')) {
+            cursor = mangled_call_offset(cursor + 1);
+        } else if (cursor[0] == 'T' && cursor[1] == 'c') {
+            cursor = mangled_call_offset(cursor + 2);
+            cursor = cursor ? mangled_call_offset(cursor) : NULL;
+        } else if ((cursor[0] == 'T' || cursor[0] == 'G') && cursor[1] != '\0') {
+            cursor += 2;
+        }
+        if (!cursor) {
+            *length = strlen(name);
+            return name;
+        }
+        // Local entities are grouped with their enclosing function,
+        // internal linkage (L, file scope static) is skipped wherever a name starts
+        if (*cursor == 'L') {
+            cursor++;
+        }
+        if (*cursor == 'Z') {
+            cursor++;
+            if (*cursor == 'L')
+                cursor++;
+        }
+        if (*cursor == 'N') {
+            cursor++;
+            while (*cursor != '\0' && strchr("rVKRO", *cursor)) {
+                cursor++;
+            }
+            if (*cursor == 'L')
+                cursor++;
+        }
+        // St is std:: and Sa, Sb, Ss, Si, So, Sd are std:: abbreviations
+        if (cursor[0] == 'S' && cursor[1] != '\0' && strchr("tabsiod", cursor[1])) {
+            *length = 3;
+            return "std";
+        }
+        const char *source = mangled_source_name(cursor, length);
+        if (source) {
+            return source;
+        }
+        *length = strlen(name);
+        return name;
+    }
+
+    while (*cursor == '_' || *cursor == '.') {
+        cursor++;
+    }
+    if (*cursor == '\0') {
+        *length = strlen(name);
+        return name;
+    }
+
+    *length = strcspn(cursor, "_.@$");
+    return cursor;
+}
+
+// FNV-1a hash of a string that may not be terminated
+uint64_t hash_string(const char *string, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) string[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
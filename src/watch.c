@@ -0,0 +1,495 @@
+#define _GNU_SOURCE
+#include "watch.h"
+#include "tools.h"
+#include <dirent.h>
+#include <elf.h>
+#include <err.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Return the name at offset in a copied string table, or an empty string when out of bounds
+static const char *watch_name(const char *table, size_t size, size_t offset) {
+    if (!table || offset >= size)
+        return "";
+    return &table[offset];
+}
+
+static void watch_free_snapshot(watch_snapshot *snapshot) {
+    free(snapshot->sections);
+    free(snapshot->section_names);
+    free(snapshot->symbols);
+    free(snapshot->symbol_names);
+}
+
+// Read size bytes at offset and terminate them, NULL when out of the file or on a short read
+static char *watch_read(int fd, size_t file_size, size_t offset, size_t size) {
+    if (offset > file_size || size > file_size - offset)
+        return NULL;
+
+    char *buffer = calloc(size + 1, sizeof(char));
+    if (!buffer)
+        errx(1, "Cannot malloc watch buffer !");
+
+    for (size_t done = 0; done < size;) {
+        ssize_t length = pread(fd, buffer + done, size - done, (off_t) (offset + done));
+        if (length <= 0) {
+            free(buffer);
+            return NULL;
+        }
+        done += (size_t) length;
+    }
+    return buffer;
+}
+
+// Keep the header, the section table and the symbol table of an ELF file.
+// Only the header is read from other files, return 0 for them.
+static int watch_parse(const char *path, watch_snapshot *snapshot) {
+    // A link moved into the tree is not followed either
+    int fd = open(path, O_RDONLY | O_NOFOLLOW);
+    struct stat status;
+    ElfW(Ehdr) header;
+
+    if (fd < 0)
+        return 0;
+
+    if (fstat(fd, &status) < 0 || !S_ISREG(status.st_mode) || pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) || memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 || header.e_ehsize != sizeof(ElfW(Ehdr)) || (header.e_shnum && header.e_shentsize != sizeof(ElfW(Shdr)))) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = (size_t) status.st_size;
+    size_t nb_sections = header.e_shnum;
+    memset(snapshot, 0, sizeof(watch_snapshot));
+    snapshot->header = header;
+
+    snapshot->sections = (ElfW(Shdr) *) watch_read(fd, size, header.e_shoff, nb_sections * sizeof(ElfW(Shdr)));
+    if (!snapshot->sections) {
+        close(fd);
+        return 0;
+    }
+    ElfW(Shdr) *sections = snapshot->sections;
+
+    // Section names
+    if (header.e_shstrndx < nb_sections) {
+        ElfW(Shdr) *names = &sections[header.e_shstrndx];
+        snapshot->section_names = watch_read(fd, size, names->sh_offset, names->sh_size);
+        snapshot->section_names_size = snapshot->section_names ? names->sh_size : 0;
+    }
+
+    // Symbol table, the dynamic one when the file is stripped
+    ElfW(Shdr) *symbol = NULL;
+    for (size_t i = 0; i < nb_sections; i++) {
+        if (sections[i].sh_type == SHT_SYMTAB || (sections[i].sh_type == SHT_DYNSYM && !symbol))
+            symbol = &sections[i];
+    }
+    if (symbol && symbol->sh_link < nb_sections) {
+        ElfW(Shdr) *names = &sections[symbol->sh_link];
+        snapshot->symbols = (ElfW(Sym) *) watch_read(fd, size, symbol->sh_offset, symbol->sh_size);
+        snapshot->nb_symbols = snapshot->symbols ? symbol->sh_size / sizeof(ElfW(Sym)) : 0;
+        snapshot->symbol_names = watch_read(fd, size, names->sh_offset, names->sh_size);
+        snapshot->symbol_names_size = snapshot->symbol_names ? names->sh_size : 0;
+    }
+
+    close(fd);
+    return 1;
+}
+
+// Print header fields that changed, return the number of changes
+static size_t watch_diff_header(ElfW(Ehdr) * old, ElfW(Ehdr) * new) {
+    size_t changes = 0;
+    const struct {
+        const char *title;
+        size_t old;
+        size_t new;
+    } fields[] = {
+            {"Type:", old->e_type, new->e_type},
+            {"Machine:", old->e_machine, new->e_machine},
+            {"Version:", old->e_version, new->e_version},
+            {"Entry point address:", old->e_entry, new->e_entry},
+            {"Start of program headers:", old->e_phoff, new->e_phoff},
+            {"Start of section headers:", old->e_shoff, new->e_shoff},
+            {"Flags:", old->e_flags, new->e_flags},
+            {"Number of program headers:", old->e_phnum, new->e_phnum},
+            {"Number of section headers:", old->e_shnum, new->e_shnum},
+            {"Section header string table index:", old->e_shstrndx, new->e_shstrndx}};
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (fields[i].old != fields[i].new) {
+            printer_indent(fields[i].title, "0x%zx -> 0x%zx", fields[i].old, fields[i].new);
+            changes++;
+        }
+    }
+    return changes;
+}
+
+static int compare_watch_section(const void *a, const void *b) {
+    const watch_section *left = a;
+    const watch_section *right = b;
+    int order = strcmp(left->name, right->name);
+
+    if (order)
+        return order;
+    return (left->section > right->section) - (left->section < right->section);
+}
+
+// Sort the sections of a snapshot by name, same-named sections keep their order
+static size_t watch_sort_sections(watch_snapshot *snapshot, watch_section **sorted) {
+    size_t number = snapshot->header.e_shnum;
+
+    *sorted = calloc(number ? number : 1, sizeof(watch_section));
+    if (!*sorted)
+        errx(1, "Cannot malloc section table !");
+
+    for (size_t i = 0; i < number; i++) {
+        (*sorted)[i].name = watch_name(snapshot->section_names, snapshot->section_names_size, snapshot->sections[i].sh_name);
+        (*sorted)[i].section = &snapshot->sections[i];
+    }
+    qsort(*sorted, number, sizeof(watch_section), compare_watch_section);
+    return number;
+}
+
+// Print the fields of a section that changed, return 0 when none did
+static int watch_diff_section(const char *name, const ElfW(Shdr) * previous, const ElfW(Shdr) * section) {
+    const struct {
+        const char *title;
+        size_t old;
+        size_t new;
+    } fields[] = {
+            {"type", previous->sh_type, section->sh_type},
+            {"flags", previous->sh_flags, section->sh_flags},
+            {"address", previous->sh_addr, section->sh_addr},
+            {"offset", previous->sh_offset, section->sh_offset},
+            {"size", previous->sh_size, section->sh_size}};
+    int changed = 0;
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (fields[i].old == fields[i].new)
+            continue;
+        if (!changed)
+            printf(INDENT "~ section %s:", name);
+        printf("%s %s 0x%zx -> 0x%zx", changed ? "," : "", fields[i].title, fields[i].old, fields[i].new);
+        changed = 1;
+    }
+    if (changed)
+        putchar('\n');
+    return changed;
+}
+
+// Print sections added, removed or changed by merging both sorted tables, return the number of changes.
+// Same-named sections (.group, .rela.text...) are paired in order.
+static size_t watch_diff_sections(watch_snapshot *old, watch_snapshot *new) {
+    watch_section *old_sections = NULL;
+    watch_section *new_sections = NULL;
+    size_t nb_old = watch_sort_sections(old, &old_sections);
+    size_t nb_new = watch_sort_sections(new, &new_sections);
+    size_t changes = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < nb_old || j < nb_new) {
+        int order = i == nb_old ? 1 : j == nb_new ? -1 : strcmp(old_sections[i].name, new_sections[j].name);
+
+        if (order < 0) {
+            printf(INDENT "- section %s\n", old_sections[i].name);
+            i++;
+            changes++;
+        } else if (order > 0) {
+            printf(INDENT "+ section %s (size 0x%zx)\n", new_sections[j].name, (size_t) new_sections[j].section->sh_size);
+            j++;
+            changes++;
+        } else {
+            changes += (size_t) watch_diff_section(new_sections[j].name, old_sections[i].section, new_sections[j].section);
+            i++;
+            j++;
+        }
+    }
+
+    free(old_sections);
+    free(new_sections);
+    return changes;
+}
+
+static int compare_watch_symbol(const void *a, const void *b) {
+    const watch_symbol *left = a;
+    const watch_symbol *right = b;
+    int order = strcmp(left->name, right->name);
+
+    if (order)
+        return order;
+    return (left->symbol->st_value > right->symbol->st_value) - (left->symbol->st_value < right->symbol->st_value);
+}
+
+// Sort the named symbols of a snapshot, return their number
+static size_t watch_sort_symbols(watch_snapshot *snapshot, watch_symbol **sorted) {
+    size_t number = 0;
+
+    *sorted = calloc(snapshot->nb_symbols ? snapshot->nb_symbols : 1, sizeof(watch_symbol));
+    if (!*sorted)
+        errx(1, "Cannot malloc symbol table !");
+
+    for (size_t i = 1; i < snapshot->nb_symbols; i++) {
+        const char *name = watch_name(snapshot->symbol_names, snapshot->symbol_names_size, snapshot->symbols[i].st_name);
+        if (*name) {
+            (*sorted)[number].name = name;
+            (*sorted)[number].symbol = &snapshot->symbols[i];
+            number++;
+        }
+    }
+    qsort(*sorted, number, sizeof(watch_symbol), compare_watch_symbol);
+    return number;
+}
+
+// Print the fields of a symbol that changed, return 0 when none did
+static int watch_diff_symbol(const char *name, const ElfW(Sym) * previous, const ElfW(Sym) * symbol) {
+    const struct {
+        const char *title;
+        size_t old;
+        size_t new;
+    } fields[] = {
+            {"value", previous->st_value, symbol->st_value},
+            {"size", previous->st_size, symbol->st_size},
+            {"type", ELF64_ST_TYPE(previous->st_info), ELF64_ST_TYPE(symbol->st_info)},
+            {"binding", ELF64_ST_BIND(previous->st_info), ELF64_ST_BIND(symbol->st_info)}};
+    int changed = 0;
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (fields[i].old == fields[i].new)
+            continue;
+        if (!changed)
+            printf(INDENT "~ symbol %s:", name);
+        printf("%s %s 0x%zx -> 0x%zx", changed ? "," : "", fields[i].title, fields[i].old, fields[i].new);
+        changed = 1;
+    }
+    if (changed)
+        putchar('\n');
+    return changed;
+}
+
+// Print symbols added, removed or changed by merging both sorted tables, return the number of changes
+static size_t watch_diff_symbols(watch_snapshot *old, watch_snapshot *new) {
+    watch_symbol *old_symbols = NULL;
+    watch_symbol *new_symbols = NULL;
+    size_t nb_old = watch_sort_symbols(old, &old_symbols);
+    size_t nb_new = watch_sort_symbols(new, &new_symbols);
+    size_t changes = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < nb_old || j < nb_new) {
+        int order = i == nb_old ? 1 : j == nb_new ? -1 : strcmp(old_symbols[i].name, new_symbols[j].name);
+
+        if (order < 0) {
+            printf(INDENT "- symbol %s\n", old_symbols[i].name);
+            i++;
+            changes++;
+        } else if (order > 0) {
+            printf(INDENT "+ symbol %s (size %zu)\n", new_symbols[j].name, (size_t) new_symbols[j].symbol->st_size);
+            j++;
+            changes++;
+        } else {
+            changes += (size_t) watch_diff_symbol(new_symbols[j].name, old_symbols[i].symbol, new_symbols[j].symbol);
+            i++;
+            j++;
+        }
+    }
+
+    free(old_symbols);
+    free(new_symbols);
+    return changes;
+}
+
+// Find the cached entry of a path
+static watch_entry *watch_find(watch_context *context, const char *path) {
+    if (!context->nb_buckets)
+        return NULL;
+
+    watch_entry *entry = context->entries[hash_string(path, strlen(path)) & (context->nb_buckets - 1)];
+    while (entry && strcmp(entry->path, path) != 0) {
+        entry = entry->next;
+    }
+    return entry;
+}
+
+// Cache an entry, doubling the buckets when there are more entries than buckets
+static void watch_insert(watch_context *context, watch_entry *entry) {
+    if (context->nb_entries + 1 > context->nb_buckets) {
+        size_t nb_buckets = context->nb_buckets ? context->nb_buckets * 2 : WATCH_BUCKETS;
+        watch_entry **buckets = calloc(nb_buckets, sizeof(watch_entry *));
+        if (!buckets)
+            errx(1, "Cannot malloc watch entries !");
+
+        for (size_t i = 0; i < context->nb_buckets; i++) {
+            for (watch_entry *current = context->entries[i], *next; current; current = next) {
+                size_t bucket = hash_string(current->path, strlen(current->path)) & (nb_buckets - 1);
+                next = current->next;
+                current->next = buckets[bucket];
+                buckets[bucket] = current;
+            }
+        }
+        free(context->entries);
+        context->entries = buckets;
+        context->nb_buckets = nb_buckets;
+    }
+
+    size_t bucket = hash_string(entry->path, strlen(entry->path)) & (context->nb_buckets - 1);
+    entry->next = context->entries[bucket];
+    context->entries[bucket] = entry;
+    context->nb_entries++;
+}
+
+// Mark a file as removed, its snapshot is kept since linkers unlink their output before writing it again
+static void watch_remove(watch_context *context, const char *path) {
+    watch_entry *entry = watch_find(context, path);
+
+    if (entry && !entry->removed) {
+        printf("==> %s (removed)\n", path);
+        entry->removed = 1;
+    }
+}
+
+// Re-parse a file and report what changed since the cached parse
+static void watch_update(watch_context *context, const char *path, int report) {
+    watch_entry *entry = watch_find(context, path);
+
+    watch_snapshot snapshot;
+    if (!watch_parse(path, &snapshot)) {
+        // No longer an ELF file
+        watch_remove(context, path);
+        return;
+    }
+
+    if (!entry) {
+        entry = calloc(1, sizeof(watch_entry));
+        if (!entry)
+            errx(1, "Cannot malloc watch entry !");
+        entry->path = malloc(strlen(path) + 1);
+        if (!entry->path)
+            errx(1, "Cannot malloc watch entry !");
+        strcpy(entry->path, path);
+        entry->snapshot = snapshot;
+        watch_insert(context, entry);
+
+        if (report)
+            printf("==> %s (new): %d sections, %zu symbols\n", path, snapshot.header.e_shnum, snapshot.nb_symbols);
+        return;
+    }
+
+    printf("==> %s (%s)\n", path, entry->removed ? "rewritten" : "changed");
+    entry->removed = 0;
+    size_t changes = watch_diff_header(&entry->snapshot.header, &snapshot.header);
+    changes += watch_diff_sections(&entry->snapshot, &snapshot);
+    changes += watch_diff_symbols(&entry->snapshot, &snapshot);
+    if (changes == 0)
+        puts(INDENT "No changes in header, sections or symbols.");
+
+    watch_free_snapshot(&entry->snapshot);
+    entry->snapshot = snapshot;
+}
+
+static char *watch_join(const char *directory, const char *name) {
+    size_t length = strlen(directory) + strlen(name) + 2;
+    char *path = malloc(length);
+
+    if (!path)
+        errx(1, "Cannot malloc path !");
+
+    snprintf(path, length, "%s/%s", directory, name);
+    return path;
+}
+
+// Watch a directory and its subdirectories, parsing the ELF files already there
+static void watch_add_directory(watch_context *context, const char *directory, int report) {
+    int wd = inotify_add_watch(context->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_DONT_FOLLOW | IN_ONLYDIR);
+    if (wd < 0) {
+        warn("Cannot watch %s", directory);
+        return;
+    }
+
+    // Watch descriptors are small increasing integers
+    if ((size_t) wd >= context->nb_paths) {
+        size_t nb_paths = ((size_t) wd + 1) * 2;
+        char **paths = realloc(context->paths, nb_paths * sizeof(char *));
+        if (!paths)
+            errx(1, "Cannot realloc watch paths !");
+        memset(paths + context->nb_paths, 0, (nb_paths - context->nb_paths) * sizeof(char *));
+        context->paths = paths;
+        context->nb_paths = nb_paths;
+    }
+    free(context->paths[wd]);
+    context->paths[wd] = malloc(strlen(directory) + 1);
+    if (!context->paths[wd])
+        errx(1, "Cannot malloc watch paths !");
+    strcpy(context->paths[wd], directory);
+
+    DIR *dir = opendir(directory);
+    if (!dir)
+        return;
+
+    struct dirent *file;
+    while ((file = readdir(dir))) {
+        if (strcmp(file->d_name, ".") == 0 || strcmp(file->d_name, "..") == 0)
+            continue;
+
+        // Symbolic links are not followed, a loop would be walked forever and a linked
+        // file would be cached under a name inotify never reports
+        char *path = watch_join(directory, file->d_name);
+        struct stat status;
+        if (lstat(path, &status) == 0) {
+            if (S_ISDIR(status.st_mode))
+                watch_add_directory(context, path, report);
+            else if (S_ISREG(status.st_mode))
+                watch_update(context, path, report);
+        }
+        free(path);
+    }
+    closedir(dir);
+}
+
+// Watch a build tree and report header, section and symbol changes of rewritten ELF files
+void watch_directory(const char *path) {
+    watch_context context = {.fd = inotify_init(), .paths = NULL, .nb_paths = 0, .entries = NULL, .nb_buckets = 0, .nb_entries = 0};
+    if (context.fd < 0)
+        err(1, "Cannot initialize inotify");
+
+    watch_add_directory(&context, path, 0);
+
+    printf("Watching %s (%zu ELF files)\n", path, context.nb_entries);
+    fflush(stdout);
+
+    char buffer[WATCH_EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t length = read(context.fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            err(1, "Cannot read inotify events");
+
+        for (char *cursor = buffer; cursor < buffer + length;) {
+            struct inotify_event *event = (struct inotify_event *) cursor;
+            cursor += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                puts("Event queue overflow, some changes may be missed.");
+                continue;
+            }
+            if (!event->len || event->wd < 0 || (size_t) event->wd >= context.nb_paths || !context.paths[event->wd])
+                continue;
+
+            char *file = watch_join(context.paths[event->wd], event->name);
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    watch_add_directory(&context, file, 1);
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                watch_update(&context, file, 1);
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                watch_remove(&context, file);
+            }
+            free(file);
+        }
+        fflush(stdout);
+    }
+}